@@ -0,0 +1,660 @@
+// Throughput of the simulator core, without Pin. Synthetic access streams
+// are generated up front, then timed through a single cache of every level
+// and geometry, and through whole per-thread hierarchies built by InitCache:
+//
+//   cache_bench [-n ACCESSES] [-w KB] [-t THREADS] [-g KB:LINE:WAYS]... [-o out]
+//
+// -n accesses per stream, -w working set of the random streams, -t threads
+// of the multi-threaded mix, -g extra geometries to time. Results are one
+// ';'-separated line per stream and target, to track the simulator
+// performance over time.
+//
+// A stream of basic blocks is also run through the coalescing of the
+// pintool, whose statistics must match simulating every access; the bench
+// exits with an error if they do not.
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <time.h>
+
+#include "pin_shim.H"
+
+#include "cache.H"
+#include "cache_parameters.H"
+
+
+// One access of a synthetic stream
+struct BENCH_ACCESS
+{
+    ADDRINT _addr;
+    UINT32 _size;
+    UINT32 _accessType;
+};
+
+enum BENCH_STREAM {
+    BENCH_SEQUENTIAL,   // 8 byte loads, one after the other
+    BENCH_STRIDED,      // 8 byte loads every 4KB + 64B
+    BENCH_RANDOM,       // Loads and stores, uniform over the working set
+    BENCH_POINTER_CHASE,// Loads of the lines of the working set, in a random cycle
+    BENCH_UNALIGNED,    // 16 byte loads and stores crossing two lines
+    BENCH_MIX,          // Instruction fetches, sequential and random data, per thread
+    BENCH_BLOCKS,       // Basic blocks of the coalescing check
+    BENCH_STREAM_NUM
+};
+
+static const char *StreamNames[BENCH_STREAM_NUM] = { "SEQUENTIAL", "STRIDED", "RANDOM", "POINTER_CHASE", "UNALIGNED", "MIX", "BLOCKS" };
+
+#define BENCH_BASE_ADDR 0x10000000 // Data addresses start here, code at 0x400000
+
+UINT64 NumAccesses = 4*KILO*KILO;
+UINT64 WorkingSet = 16*KILO*KILO;
+UINT32 NumThreads = 4;
+volatile UINT64 Sink;              // Keeps the accesses from being optimized away
+
+
+static UINT64 Random(UINT64 &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+
+static VOID Generate(BENCH_STREAM stream, BENCH_ACCESS *accesses, UINT64 n, UINT64 seed)
+{
+    const UINT64 lines = WorkingSet / 64;
+    UINT64 state = seed * 0x9e3779b97f4a7c15ULL + 1;
+    ADDRINT pc = 0x400000;
+    UINT64 i;
+
+    switch (stream){
+      case BENCH_SEQUENTIAL:
+        for (i = 0; i < n; i++){
+            accesses[i]._addr = BENCH_BASE_ADDR + i * 8;
+            accesses[i]._size = 8;
+            accesses[i]._accessType = ACCESS_TYPE_LOAD;
+        }
+        break;
+
+      case BENCH_STRIDED:
+        for (i = 0; i < n; i++){
+            accesses[i]._addr = BENCH_BASE_ADDR + (i * (4*KILO + 64)) % (64*KILO*KILO);
+            accesses[i]._size = 8;
+            accesses[i]._accessType = ACCESS_TYPE_LOAD;
+        }
+        break;
+
+      case BENCH_RANDOM:
+        for (i = 0; i < n; i++){
+            UINT64 r = Random(state);
+            accesses[i]._addr = BENCH_BASE_ADDR + (r % (WorkingSet / 8)) * 8;
+            accesses[i]._size = 8;
+            accesses[i]._accessType = (r >> 60) < 4 ? ACCESS_TYPE_STORE : ACCESS_TYPE_LOAD;
+        }
+        break;
+
+      case BENCH_POINTER_CHASE:{
+        // Sattolo's shuffle gives a single cycle through every line
+        vector<UINT64> next(lines);
+        for (i = 0; i < lines; i++)
+            next[i] = i;
+        for (i = lines - 1; i > 0; i--)
+            swap(next[i], next[Random(state) % i]);
+
+        UINT64 line = 0;
+        for (i = 0; i < n; i++){
+            accesses[i]._addr = BENCH_BASE_ADDR + line * 64 + 8;
+            accesses[i]._size = 8;
+            accesses[i]._accessType = ACCESS_TYPE_LOAD;
+            line = next[line];
+        }
+        break;
+      }
+
+      case BENCH_UNALIGNED:
+        for (i = 0; i < n; i++){
+            UINT64 r = Random(state);
+            accesses[i]._addr = BENCH_BASE_ADDR + (r % lines) * 64 + 56;
+            accesses[i]._size = 16;
+            accesses[i]._accessType = (r >> 60) < 4 ? ACCESS_TYPE_STORE : ACCESS_TYPE_LOAD;
+        }
+        break;
+
+      case BENCH_MIX:
+        // Roughly one fetch per memory access, jumping now and then
+        for (i = 0; i < n; i++){
+            UINT64 r = Random(state);
+            if (i % 2 == 0){
+                pc = (r >> 56) == 0 ? 0x400000 + (r % (64*KILO)) : pc + 4;
+                accesses[i]._addr = pc;
+                accesses[i]._size = 4;
+                accesses[i]._accessType = ACCESS_TYPE_INSTRUCTION;
+            }
+            else if ((r >> 62) == 0){
+                accesses[i]._addr = BENCH_BASE_ADDR + (r % (WorkingSet / 8)) * 8;
+                accesses[i]._size = 8;
+                accesses[i]._accessType = ACCESS_TYPE_STORE;
+            }
+            else{
+                accesses[i]._addr = BENCH_BASE_ADDR + seed * WorkingSet + (i * 4) % WorkingSet;
+                accesses[i]._size = 8;
+                accesses[i]._accessType = ACCESS_TYPE_LOAD;
+            }
+        }
+        break;
+
+      default:
+        break;
+    }
+}
+
+
+static double Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static VOID RunCache(CACHE_BASE *cache, const BENCH_ACCESS *accesses, UINT64 n)
+{
+    UINT64 hits = 0;
+
+    for (UINT64 i = 0; i < n; i++)
+        hits += cache->Access(accesses[i]._addr, accesses[i]._size, (ACCESS_TYPE) accesses[i]._accessType, accesses[i]._addr);
+    Sink += hits;
+}
+
+
+// Same dispatch as the pintool: fetches to the L1I, the rest to the L1D
+static VOID RunHierarchy(THREAD_HIERARCHY *hierarchy, const BENCH_ACCESS *accesses, UINT64 n)
+{
+    UINT64 hits = 0;
+
+    for (UINT64 i = 0; i < n; i++){
+        const BENCH_ACCESS &access = accesses[i];
+        hierarchy->CountAccess[access._accessType]++;
+        if (access._accessType == ACCESS_TYPE_INSTRUCTION)
+            hits += hierarchy->il1.Access(access._addr, access._size, ACCESS_TYPE_INSTRUCTION, access._addr);
+        else
+            hits += hierarchy->dl1[0].Access(access._addr, access._size, (ACCESS_TYPE) access._accessType, access._addr);
+    }
+    Sink += hits;
+}
+
+
+static VOID WriteResult(FILE *out, BENCH_STREAM stream, const char *target, CACHE_PARAMS &params,
+                        UINT32 threads, UINT64 accesses, double seconds, double missRatio)
+{
+    fprintf(out,"%s;%s;%u;%u;%u;%u;%llu;%.6f;%.0f;%.3f;%.6f;",StreamNames[stream], target,
+            params._cacheSize * KILO, params._lineSize, params._associativity, threads,
+            (CACHE_STATS) accesses, seconds, accesses / seconds, seconds * 1e9 / accesses, missRatio);
+    fprintf(out,"\n");
+    fflush(out);
+}
+
+
+static double MissRatio(CACHE_BASE *cache)
+{
+    return cache->Accesses() ? (double) cache->Misses() / cache->Accesses() : 0;
+}
+
+
+static double MissRatio(THREAD_HIERARCHY *hierarchy)
+{
+    CACHE_STATS accesses = hierarchy->dl1[0].Accesses() + hierarchy->il1.Accesses();
+    CACHE_STATS misses = hierarchy->dl1[0].Misses() + hierarchy->il1.Misses();
+    return accesses ? (double) misses / accesses : 0;
+}
+
+
+// Empties the shared level and the caches of every registered thread, so
+// each stream starts cold on the caches built once in main
+static VOID ResetHierarchies()
+{
+    UINT32 tid, i;
+
+    for (tid = 0; tid < Threads.Size(); tid++){
+        THREAD_HIERARCHY *hierarchy = Threads.Get(tid);
+        if (hierarchy == NULL) continue;
+
+        hierarchy->il1.Reset();
+        for (i = 0; i < PRIVATE_LEVELS && i < Levels; i++)
+            hierarchy->dl1[i].Reset();
+        for (i = 0; i < ACCESS_TYPE_NUM; i++){
+            hierarchy->CountAccess[i] = 0;
+            hierarchy->FilterHits[i] = 0;
+        }
+        hierarchy->FilterLine = NO_FILTER_LINE;
+    }
+
+    if (Levels >= 3)
+        Hierarchies[2].dl1[0].Reset();
+}
+
+
+// One cache of the given geometry on its own, no next level
+static VOID BenchCache(FILE *out, BENCH_STREAM stream, const char *target, CACHE_PARAMS &params, CACHE_BASE *cache, const BENCH_ACCESS *accesses)
+{
+    cache->Reset();
+
+    double start = Now();
+    RunCache(cache, accesses, NumAccesses);
+    double seconds = Now() - start;
+
+    WriteResult(out, stream, target, params, 1, NumAccesses, seconds, MissRatio(cache));
+}
+
+
+static VOID BenchHierarchy(FILE *out, BENCH_STREAM stream, const BENCH_ACCESS *accesses)
+{
+    ResetHierarchies();
+    THREAD_HIERARCHY *hierarchy = Threads.Get(0);
+
+    double start = Now();
+    RunHierarchy(hierarchy, accesses, NumAccesses);
+    double seconds = Now() - start;
+
+    WriteResult(out, stream, "HIERARCHY", Hierarchies[0].params_dl1, 1, NumAccesses, seconds, MissRatio(hierarchy));
+}
+
+
+//==============================================================
+// Multi-threaded mix: one hierarchy per thread over a shared, sharded LLC
+//==============================================================
+struct BENCH_THREAD
+{
+    pthread_t _thread;
+    THREAD_HIERARCHY *_hierarchy;
+    BENCH_ACCESS *_accesses;
+};
+
+volatile UINT32 ThreadsReady = 0;
+volatile bool ThreadsGo = false;
+
+
+static VOID *BenchThread(VOID *arg)
+{
+    BENCH_THREAD *thread = (BENCH_THREAD *) arg;
+
+    __sync_fetch_and_add(&ThreadsReady, 1);
+    while (!ThreadsGo)
+        sched_yield();
+
+    RunHierarchy(thread->_hierarchy, thread->_accesses, NumAccesses);
+    return NULL;
+}
+
+
+static VOID BenchThreads(FILE *out, BENCH_STREAM stream)
+{
+    vector<BENCH_THREAD> threads(NumThreads);
+    double missRatio = 0;
+    UINT32 i;
+
+    if (Levels >= 3 && !Hierarchies[2].dl1[0].IsShared())
+        Hierarchies[2].dl1[0].SetShared(SHARED_CACHE_SHARDS);
+
+    for (i = 0; i < NumThreads; i++){
+        threads[i]._hierarchy = ThreadHierarchy(i);
+        threads[i]._accesses = new BENCH_ACCESS[NumAccesses];
+        Generate(stream, threads[i]._accesses, NumAccesses, i + 1);
+    }
+    ResetHierarchies();
+
+    ThreadsReady = 0;
+    ThreadsGo = false;
+    for (i = 0; i < NumThreads; i++)
+        pthread_create(&threads[i]._thread, NULL, BenchThread, &threads[i]);
+    while (ThreadsReady < NumThreads)
+        sched_yield();
+
+    double start = Now();
+    ThreadsGo = true;
+    for (i = 0; i < NumThreads; i++)
+        pthread_join(threads[i]._thread, NULL);
+    double seconds = Now() - start;
+
+    for (i = 0; i < NumThreads; i++){
+        missRatio += MissRatio(threads[i]._hierarchy) / NumThreads;
+        delete [] threads[i]._accesses;
+    }
+
+    WriteResult(out, stream, "HIERARCHY", Hierarchies[0].params_dl1, NumThreads, NumAccesses * NumThreads, seconds, missRatio);
+}
+
+
+//==============================================================
+// Coalescing check: basic blocks simulated access by access, and with the
+// fetch runs and the line filter of the pintool
+//==============================================================
+#define BENCH_BLOCK_COUNT 1024
+#define BENCH_BLOCK_INS 20       // Instructions per block, at most
+#define BENCH_NO_DATA ACCESS_TYPE_NUM
+
+struct BENCH_INS
+{
+    ADDRINT _pc;
+    UINT32 _size;
+    UINT32 _accessType;   // BENCH_NO_DATA for instructions without data access
+    UINT32 _dataSize;
+    ADDRINT _base;        // Data addresses start here and advance by _stride
+    UINT32 _stride;
+    bool _random;         // Data addresses uniform over the working set instead
+    UINT32 _run;          // Fetches coalesced from here, 0 inside a run
+    bool _rep;            // Fetch and access once per iteration
+};
+
+typedef vector<BENCH_INS> BENCH_BLOCK;
+
+
+// Code at 0x400000, data mostly starting in a small hot region, the rest
+// over the working set, with some accesses crossing lines
+static VOID GenerateBlocks(vector<BENCH_BLOCK> &blocks, UINT64 seed)
+{
+    UINT64 state = seed * 0x9e3779b97f4a7c15ULL + 1;
+    UINT32 i, k;
+
+    for (i = 0; i < blocks.size(); i++){
+        ADDRINT pc = 0x400000 + Random(state) % (256*KILO);
+        UINT32 n = 1 + Random(state) % BENCH_BLOCK_INS;
+
+        for (k = 0; k < n; k++){
+            BENCH_INS ins;
+            UINT64 r = Random(state);
+
+            ins._pc = pc;
+            ins._size = 1 + r % 11;
+            ins._rep = (r >> 8) % 50 == 0;
+            ins._accessType = (r >> 16) % 3 == 0 ? BENCH_NO_DATA : (r >> 20) % 3 == 0 ? ACCESS_TYPE_STORE : ACCESS_TYPE_LOAD;
+            ins._dataSize = 1 << ((r >> 24) % 5);
+            ins._base = BENCH_BASE_ADDR + ((r >> 28) % 4 == 0 ? (r >> 32) % WorkingSet : (r >> 32) % 512);
+            ins._random = (r >> 40) % 4 == 0;
+            ins._stride = (r >> 44) % 2 ? 0 : ins._dataSize;
+            ins._run = 0;
+            blocks[i].push_back(ins);
+            pc += ins._size;
+        }
+    }
+}
+
+
+// Fetch runs split as in InstructionTrace
+static VOID MarkRuns(vector<BENCH_BLOCK> &blocks)
+{
+    vector<FETCH_INS> fetches;
+    vector<UINT32> runs;
+
+    for (UINT32 i = 0; i < blocks.size(); i++){
+        BENCH_BLOCK &block = blocks[i];
+
+        fetches.resize(block.size());
+        runs.resize(block.size());
+        for (UINT32 k = 0; k < block.size(); k++){
+            fetches[k]._addr = block[k]._pc;
+            fetches[k]._size = block[k]._size;
+            fetches[k]._rep = block[k]._rep;
+        }
+
+        FetchRuns(&fetches[0], block.size(), &runs[0]);
+        for (UINT32 k = 0; k < block.size(); k++)
+            block[k]._run = runs[k];
+    }
+}
+
+
+static inline VOID RunData(THREAD_HIERARCHY *hierarchy, BENCH_INS &ins, ADDRINT addr, bool coalesce)
+{
+    const ACCESS_TYPE accessType = (ACCESS_TYPE) ins._accessType;
+    CACHE_BASE *cache = &hierarchy->dl1[0];
+
+    if (coalesce && FilterRepeat(hierarchy, addr, ins._dataSize, accessType))
+        return;
+
+    hierarchy->CountAccess[accessType]++;
+    OPERATION op = cache->Access(addr, ins._dataSize, accessType, ins._pc);
+    if (coalesce)
+        ArmFilter(hierarchy, cache, addr, ins._dataSize, accessType, op);
+}
+
+
+// Executes random blocks until about NumAccesses accesses, returns how many
+static UINT64 RunBlocks(THREAD_HIERARCHY *hierarchy, vector<BENCH_BLOCK> &blocks, bool coalesce)
+{
+    vector<UINT64> executions(blocks.size() * BENCH_BLOCK_INS, 0);
+    UINT64 state = 12345;
+    UINT64 accesses = 0;
+
+    while (accesses < NumAccesses){
+        UINT32 b = Random(state) % blocks.size();
+        BENCH_BLOCK &block = blocks[b];
+
+        for (UINT32 k = 0; k < block.size(); k++){
+            BENCH_INS &ins = block[k];
+            UINT32 iterations = ins._rep ? Random(state) % 4 : 1;
+
+            for (UINT32 it = 0; it < iterations; it++){
+                if (!coalesce){
+                    hierarchy->CountAccess[ACCESS_TYPE_INSTRUCTION]++;
+                    hierarchy->il1.Access(ins._pc, ins._size, ACCESS_TYPE_INSTRUCTION, ins._pc);
+                }
+                else if (ins._run > 0){
+                    hierarchy->CountAccess[ACCESS_TYPE_INSTRUCTION]++;
+                    hierarchy->il1.Access(ins._pc, ins._size, ACCESS_TYPE_INSTRUCTION, ins._pc);
+                    if (ins._run > 1)
+                        CountLineHits(hierarchy, ins._pc, ins._run - 1);
+                }
+                accesses++;
+
+                if (ins._accessType == BENCH_NO_DATA)
+                    continue;
+
+                UINT64 &n = executions[b * BENCH_BLOCK_INS + k];
+                ADDRINT addr = ins._random ? BENCH_BASE_ADDR + Random(state) % WorkingSet
+                                           : ins._base + (n++ * ins._stride) % (64*KILO);
+                RunData(hierarchy, ins, addr, coalesce);
+                accesses++;
+            }
+        }
+    }
+
+    FlushFilters();
+    return accesses;
+}
+
+
+// Counters of the report: accesses, then hits, misses and evictions of
+// every cache the thread reaches
+static vector<CACHE_STATS> Counters(THREAD_HIERARCHY *hierarchy)
+{
+    vector<CACHE_STATS> counters;
+    vector<CACHE_BASE *> caches;
+    UINT32 i, type;
+
+    caches.push_back(&hierarchy->il1);
+    for (i = 0; i < Levels; i++)
+        caches.push_back(DataCache(i, hierarchy));
+
+    for (type = 0; type < ACCESS_TYPE_NUM; type++)
+        counters.push_back(hierarchy->CountAccess[type]);
+    for (i = 0; i < caches.size(); i++){
+        for (type = 0; type < ACCESS_TYPE_NUM; type++){
+            counters.push_back(caches[i]->Hits((ACCESS_TYPE) type));
+            counters.push_back(caches[i]->Misses((ACCESS_TYPE) type));
+        }
+        counters.push_back(caches[i]->EvictedLines());
+    }
+    return counters;
+}
+
+
+// Returns the number of counters that differ
+static UINT32 CheckCoalescing(FILE *out)
+{
+    vector<BENCH_BLOCK> blocks(BENCH_BLOCK_COUNT);
+    vector<CACHE_STATS> counters[2];
+    THREAD_HIERARCHY *hierarchy = Threads.Get(0);
+    UINT32 mismatches = 0;
+    UINT32 i;
+
+    GenerateBlocks(blocks, 1);
+    MarkRuns(blocks);
+
+    for (i = 0; i < 2; i++){
+        ResetHierarchies();
+
+        double start = Now();
+        UINT64 accesses = RunBlocks(hierarchy, blocks, i == 1);
+        double seconds = Now() - start;
+
+        WriteResult(out, BENCH_BLOCKS, i == 1 ? "COALESCED" : "HIERARCHY", Hierarchies[0].params_dl1, 1, accesses, seconds, MissRatio(hierarchy));
+        counters[i] = Counters(hierarchy);
+    }
+
+    for (i = 0; i < counters[0].size(); i++)
+        mismatches += counters[0][i] != counters[1][i];
+
+    return mismatches;
+}
+
+
+// A thread id reused after its thread exits keeps its hierarchy, so the
+// two threads count as much as one running the whole stream. Returns the
+// number of counters that differ.
+static UINT32 CheckThreadReuse(const BENCH_ACCESS *accesses)
+{
+    vector<CACHE_STATS> counters[2];
+    THREAD_HIERARCHY *hierarchy = ThreadHierarchy(0);
+    const UINT32 size = Threads.Size();
+    const UINT64 half = NumAccesses / 2;
+    UINT32 mismatches = 0;
+    UINT32 i;
+
+    ResetHierarchies();
+    RunHierarchy(hierarchy, accesses, NumAccesses);
+    counters[0] = Counters(hierarchy);
+
+    ResetHierarchies();
+    RunHierarchy(ThreadHierarchy(0), accesses, half);
+    RunHierarchy(ThreadHierarchy(0), accesses + half, NumAccesses - half);
+    counters[1] = Counters(hierarchy);
+
+    for (i = 0; i < counters[0].size(); i++)
+        mismatches += counters[0][i] != counters[1][i];
+
+    return mismatches + (ThreadHierarchy(0) != hierarchy) + (Threads.Size() != size);
+}
+
+
+static int Usage()
+{
+    fprintf(stderr, "usage: cache_bench [-n ACCESSES] [-w KB] [-t THREADS] [-g KB:LINE:WAYS]... [-o output]\n");
+    return 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+    vector<CACHE_PARAMS> geometries;
+    const char *filename = NULL;
+    FILE *out = stdout;
+    UINT32 i, stream;
+
+    InitCacheParams();
+
+    for (i = 1; i < (UINT32) argc; i++){
+        bool ok = true;
+
+        if (!strcmp(argv[i], "-n") && i+1 < (UINT32) argc) ok = (NumAccesses = strtoull(argv[++i], NULL, 10)) > 0;
+        else if (!strcmp(argv[i], "-w") && i+1 < (UINT32) argc) ok = (WorkingSet = strtoull(argv[++i], NULL, 10) * KILO) >= 64;
+        else if (!strcmp(argv[i], "-t") && i+1 < (UINT32) argc) ok = (NumThreads = atoi(argv[++i])) > 0;
+        else if (!strcmp(argv[i], "-o") && i+1 < (UINT32) argc) filename = argv[++i];
+        else if (!strcmp(argv[i], "-g") && i+1 < (UINT32) argc){
+            CACHE_PARAMS params;
+            ok = sscanf(argv[++i], "%u:%u:%u", &params._cacheSize, &params._lineSize, &params._associativity) == 3;
+            geometries.push_back(params);
+        }
+        else ok = false;
+
+        if (!ok) return Usage();
+    }
+
+    if (filename != NULL && (out = fopen(filename, "w")) == NULL){
+        perror(filename);
+        return 1;
+    }
+
+    //=====================================================================
+    fprintf(out,"#CACHE BENCHMARK\n");
+    //=====================================================================
+#if defined(__AVX2__)
+    fprintf(out,"#SIMD;AVX2;\n");
+#elif defined(__SSE4_1__)
+    fprintf(out,"#SIMD;SSE4.1;\n");
+#else
+    fprintf(out,"#SIMD;SCALAR;\n");
+#endif
+    fprintf(out,"#STREAM;TARGET;SIZE;LINE_SIZE;ASSOCIATIVITY;THREADS;ACCESSES;SECONDS;ACCESSES_PER_SECOND;NS_PER_ACCESS;MISS_RATIO;");
+    fprintf(out,"\n");
+
+    // Every cache is built once and reset before each stream
+    const char *levelNames[3] = { "L1D", "L2", "L3" };
+    vector<CACHE_BASE> levels(3);
+    vector<CACHE_BASE> extra(geometries.size());
+
+    for (i = 0; i < levels.size(); i++){
+        CACHE_PARAMS &params = Hierarchies[i].params_dl1;
+        levels[i].Init(levelNames[i], CACHE_TYPE_DCACHE, i + 1, params._cacheSize * KILO, params._lineSize,
+                       params._associativity, (STORE_ALLOCATION) params._writeAllocate);
+    }
+    for (i = 0; i < geometries.size(); i++){
+        CACHE_PARAMS &params = geometries[i];
+        extra[i].Init("GEOMETRY", CACHE_TYPE_DCACHE, params._cacheLevel, params._cacheSize * KILO, params._lineSize,
+                      params._associativity, (STORE_ALLOCATION) params._writeAllocate);
+    }
+
+    InitCache();
+    InitCoalescing();
+    AddThreadHierarchy(0);
+
+    BENCH_ACCESS *accesses = new BENCH_ACCESS[NumAccesses];
+
+    for (stream = 0; stream < BENCH_MIX; stream++){
+        Generate((BENCH_STREAM) stream, accesses, NumAccesses, 1);
+
+        for (i = 0; i < levels.size(); i++)
+            BenchCache(out, (BENCH_STREAM) stream, levelNames[i], Hierarchies[i].params_dl1, &levels[i], accesses);
+        for (i = 0; i < geometries.size(); i++)
+            BenchCache(out, (BENCH_STREAM) stream, "GEOMETRY", geometries[i], &extra[i], accesses);
+        BenchHierarchy(out, (BENCH_STREAM) stream, accesses);
+    }
+
+    Generate(BENCH_MIX, accesses, NumAccesses, 1);
+    BenchHierarchy(out, BENCH_MIX, accesses);
+
+    UINT32 reuseMismatches = CheckThreadReuse(accesses);
+    delete [] accesses;
+
+    UINT32 mismatches = CheckCoalescing(out);
+
+    BenchThreads(out, BENCH_MIX);
+
+    if (out != stdout)
+        fclose(out);
+
+    if (mismatches){
+        fprintf(stderr, "cache_bench: coalescing changed %u counters of the BLOCKS stream\n", mismatches);
+        return 1;
+    }
+    if (reuseMismatches){
+        fprintf(stderr, "cache_bench: a reused thread id changed %u counters\n", reuseMismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,270 @@
+// Replays a trace captured with "cache_sim -trace" through the cache
+// hierarchy, without Pin. One capture can drive many configurations:
+//
+//   cache_replay [-l1d KB:LINE:WAYS] [-l1i ...] [-l2 ...] [-l3 ...] [-mrc RATE] [-ss N] [-pc] [-o out] trace
+//
+// -mrc also writes the miss ratio curves of every level, sampling RATE of
+// the lines (1 for exact curves). -ss simulates one set in N and reports
+// the extrapolated statistics as well. -pc also writes the statistics per
+// instruction address, unnamed since the images are gone.
+//
+// The threads are interleaved by epoch, TRACE_EPOCH_RECORDS accesses of one
+// thread in the order they started during capture, so the interference on
+// shared levels is only as fine as that.
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+template<class T>
+std::string to_string(const T &value) {
+    std::ostringstream os;
+    os << value;
+    return os.str();
+}
+
+
+#include "pin_shim.H"
+
+#include "cache.H"
+#include "cache_parameters.H"
+#include "trace.H"
+
+
+// The chunks of one thread and the epoch its decoder is at
+struct REPLAY_THREAD
+{
+    THREAD_HIERARCHY *_hierarchy;
+    std::vector<const UINT8 *> _chunks;   // Chunk headers, in file order
+    size_t _next;                         // Next chunk to decode
+    TRACE_DECODER _decoder;
+    UINT64 _sequence;
+};
+
+typedef std::pair<UINT64, REPLAY_THREAD *> REPLAY_EPOCH;
+
+
+// Moves the decoder past the next epoch marker, to a new chunk if the current
+// one is done. Returns 0 once the chunks of the thread are exhausted and -1
+// if the marker is missing.
+static int NextEpoch(REPLAY_THREAD *thread)
+{
+    TRACE_CHUNK_HEADER chunk;
+
+    while (thread->_decoder.Done()){
+        if (thread->_next == thread->_chunks.size()) return 0;
+        const UINT8 *header = thread->_chunks[thread->_next++];
+        memcpy(&chunk, header, sizeof(chunk));
+        thread->_decoder.Init(header + sizeof(chunk), chunk._bytes);
+    }
+    return thread->_decoder.Epoch(thread->_sequence) ? 1 : -1;
+}
+
+
+static int Usage()
+{
+    fprintf(stderr, "usage: cache_replay [-l1d KB:LINE:WAYS[:WA]] [-l1i ...] [-l2 ...] [-l3 ...] [-mrc RATE] [-ss N] [-pc] [-o output] trace\n");
+    return 1;
+}
+
+
+// KB:LINE:WAYS[:WRITE_ALLOCATE]
+static bool ParseGeometry(const char *arg, CACHE_PARAMS &params)
+{
+    unsigned size, line, ways, writeAllocate = params._writeAllocate;
+    int n = sscanf(arg, "%u:%u:%u:%u", &size, &line, &ways, &writeAllocate);
+
+    if (n < 3) return false;
+
+    params._cacheSize = size;
+    params._lineSize = line;
+    params._associativity = ways;
+    params._writeAllocate = writeAllocate;
+    return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *traceName = NULL;
+    string filename;
+    double mrcSampling = 0;
+    bool pcProfile = false;
+    int i;
+
+    InitCacheParams();
+
+    for (i = 1; i < argc; i++){
+        bool ok = true;
+
+        if (!strcmp(argv[i], "-l1d") && i+1 < argc) ok = ParseGeometry(argv[++i], Hierarchies[0].params_dl1);
+        else if (!strcmp(argv[i], "-l1i") && i+1 < argc) ok = ParseGeometry(argv[++i], Hierarchies[0].params_il1);
+        else if (!strcmp(argv[i], "-l2") && i+1 < argc) ok = ParseGeometry(argv[++i], Hierarchies[1].params_dl1);
+        else if (!strcmp(argv[i], "-l3") && i+1 < argc) ok = ParseGeometry(argv[++i], Hierarchies[2].params_dl1);
+        else if (!strcmp(argv[i], "-mrc") && i+1 < argc) ok = (mrcSampling = atof(argv[++i])) > 0 && mrcSampling <= 1;
+        else if (!strcmp(argv[i], "-ss") && i+1 < argc) ok = IsPower2(Sampling._setSampling = atoi(argv[++i])) && Sampling._setSampling > 0;
+        else if (!strcmp(argv[i], "-pc")) pcProfile = true;
+        else if (!strcmp(argv[i], "-o") && i+1 < argc) filename = argv[++i];
+        else if (argv[i][0] != '-' && traceName == NULL) traceName = argv[i];
+        else ok = false;
+
+        if (!ok) return Usage();
+    }
+    if (traceName == NULL) return Usage();
+
+    int fd = open(traceName, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0){
+        perror(traceName);
+        return 1;
+    }
+
+    const UINT8 *data = (const UINT8 *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED){
+        perror("mmap");
+        return 1;
+    }
+    madvise((void *) data, st.st_size, MADV_SEQUENTIAL);
+
+    const UINT8 *pos = data;
+    const UINT8 *end = data + st.st_size;
+
+    TRACE_FILE_HEADER header;
+    if (end - pos < (long) sizeof(header)){
+        fprintf(stderr, "%s: truncated header\n", traceName);
+        return 1;
+    }
+    memcpy(&header, pos, sizeof(header));
+    pos += sizeof(header);
+    if (memcmp(header._magic, TRACE_MAGIC, sizeof(header._magic)) != 0 || header._version != TRACE_VERSION){
+        fprintf(stderr, "%s: not a version %d cache_sim trace\n", traceName, TRACE_VERSION);
+        return 1;
+    }
+
+    InitCache();
+    if (mrcSampling > 0)
+        InitStackDistance(mrcSampling);
+    if (pcProfile)
+        InitPCProfile();
+
+    CACHE_STATS numRecords = 0;
+    std::vector<REPLAY_THREAD *> threads;
+    TRACE_CHUNK_HEADER chunk;
+    ADDRINT addr, pc;
+    UINT32 size;
+    ACCESS_TYPE accessType;
+
+    // Index the chunks of every thread
+    while (end - pos >= (long) sizeof(chunk)){
+        memcpy(&chunk, pos, sizeof(chunk));
+
+        if ((long) chunk._bytes > end - pos - (long) sizeof(chunk) || chunk._tid >= MAX_THREAD_ID){
+            fprintf(stderr, "%s: corrupt chunk at offset %ld\n", traceName, (long)(pos - data));
+            return 1;
+        }
+        if (chunk._tid >= threads.size())
+            threads.resize(chunk._tid + 1, NULL);
+        if (threads[chunk._tid] == NULL){
+            threads[chunk._tid] = new REPLAY_THREAD;
+            threads[chunk._tid]->_hierarchy = ThreadHierarchy(chunk._tid);
+            threads[chunk._tid]->_next = 0;
+            threads[chunk._tid]->_decoder.Init(NULL, 0);
+        }
+        threads[chunk._tid]->_chunks.push_back(pos);
+
+        numRecords += chunk._records;
+        pos += sizeof(chunk) + chunk._bytes;
+    }
+
+    // Replay the epochs of all threads in sequence order
+    std::priority_queue<REPLAY_EPOCH, std::vector<REPLAY_EPOCH>, std::greater<REPLAY_EPOCH> > epochs;
+    REPLAY_THREAD *thread = NULL;
+    int state = 1;
+
+    for (i = 0; i < (int) threads.size() && state >= 0; i++){
+        if (threads[i] == NULL) continue;
+        thread = threads[i];
+        if ((state = NextEpoch(thread)) > 0)
+            epochs.push(REPLAY_EPOCH(thread->_sequence, thread));
+    }
+
+    while (!epochs.empty() && state >= 0){
+        thread = epochs.top().second;
+        epochs.pop();
+
+        CACHE_BASE *dl1 = &thread->_hierarchy->dl1[0];
+        CACHE_BASE *il1 = &thread->_hierarchy->il1;
+        CACHE_STATS *counts = thread->_hierarchy->CountAccess;
+
+        while (!thread->_decoder.Done() && !thread->_decoder.AtEpoch()){
+            if (!thread->_decoder.Next(addr, size, accessType, pc)){
+                state = -1;
+                break;
+            }
+            counts[accessType]++;
+            if (accessType == ACCESS_TYPE_INSTRUCTION)
+                il1->Access(addr, size, accessType, pc);
+            else
+                dl1->Access(addr, size, accessType, pc);
+        }
+        if (state >= 0 && (state = NextEpoch(thread)) > 0)
+            epochs.push(REPLAY_EPOCH(thread->_sequence, thread));
+    }
+
+    if (state < 0){
+        fprintf(stderr, "%s: corrupt record in chunk at offset %ld\n", traceName, (long)(thread->_chunks[thread->_next - 1] - data));
+        return 1;
+    }
+
+    if (filename.empty())
+        filename = string(traceName)+"."+to_string(Hierarchies[0].params_dl1._cacheSize)+"KB"+to_string(Hierarchies[0].params_dl1._lineSize)+"B" + to_string(Levels) + "L.out";
+
+    FILE *out = fopen(filename.c_str(), "w");
+    if (out == NULL){
+        perror(filename.c_str());
+        return 1;
+    }
+
+    WriteCacheReport(out, header._flags & (TRACE_TRACKS_LOADS | TRACE_TRACKS_STORES), header._flags & TRACE_TRACKS_INSTRUCTIONS);
+
+    fclose(out);
+    cout << "Replayed " << numRecords << " accesses of " << Threads.Size() << " threads" << endl;
+    cout << "Wrote " << filename << endl;
+
+    if (mrcSampling > 0){
+        string mrcName = filename + ".mrc";
+        out = fopen(mrcName.c_str(), "w");
+        if (out == NULL){
+            perror(mrcName.c_str());
+            return 1;
+        }
+        WriteMissRatioCurves(out, header._flags & TRACE_TRACKS_INSTRUCTIONS);
+        fclose(out);
+        cout << "Wrote " << mrcName << endl;
+    }
+
+    if (pcProfile){
+        string pcName = filename + ".pc";
+        out = fopen(pcName.c_str(), "w");
+        if (out == NULL){
+            perror(pcName.c_str());
+            return 1;
+        }
+        WritePCProfiles(out, header._flags & TRACE_TRACKS_INSTRUCTIONS, NULL);
+        fclose(out);
+        cout << "Wrote " << pcName << endl;
+    }
+
+    munmap((void *) data, st.st_size);
+    close(fd);
+    return 0;
+}
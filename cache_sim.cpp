@@ -1,6 +1,8 @@
 #include <cstdlib>
+#include <cstddef>
 #include <iostream>
 #include <cstring>
+#include <map>
 #include <sstream>
 #include <string>
 
@@ -16,11 +18,27 @@ std::string to_string(const T &value) {
 
 #include "cache.H"
 #include "cache_parameters.H"
+#include "access_buffer.H"
+#include "trace.H"
 
 
 KNOB<BOOL>   KnobTrackLoads(KNOB_MODE_WRITEONCE,            "pintool",  "tl",   "1",                "track individual loads");
 KNOB<BOOL>   KnobTrackStores(KNOB_MODE_WRITEONCE,           "pintool",  "ts",   "1",                "track individual stores");
-KNOB<BOOL>   KnobTrackInstructions(KNOB_MODE_WRITEONCE,     "pintool",  "ti",   "0",                "track individual instructions -- increases profiling time");
+KNOB<BOOL>   KnobTrackInstructions(KNOB_MODE_WRITEONCE,     "pintool",  "ti",   "0",                "track instruction fetches in the instruction cache");
+KNOB<BOOL>   KnobLockFree(KNOB_MODE_WRITEONCE,              "pintool",  "lf",   "1",                "lock-free private caches and a sharded shared LLC -- 0 serializes all accesses on one global lock");
+KNOB<BOOL>   KnobBuffered(KNOB_MODE_WRITEONCE,              "pintool",  "bf",   "0",                "buffer accesses per thread and simulate them in batches on worker threads");
+KNOB<UINT32> KnobBufferWorkers(KNOB_MODE_WRITEONCE,         "pintool",  "bw",   "2",                "number of simulation worker threads in buffered mode");
+KNOB<UINT32> KnobBufferPages(KNOB_MODE_WRITEONCE,           "pintool",  "bp",   "64",               "pages per thread buffer in buffered mode");
+KNOB<string> KnobTraceFile(KNOB_MODE_WRITEONCE,             "pintool",  "trace","",                 "capture a binary access trace to this file instead of simulating -- replay it with cache_replay");
+KNOB<BOOL>   KnobMissRatioCurves(KNOB_MODE_WRITEONCE,       "pintool",  "mrc",  "0",                "write miss ratio curves of every level from LRU stack distances -- the shared level profiles under one lock, lower -mrcs to take it less often");
+KNOB<FLT64>  KnobMissRatioSampling(KNOB_MODE_WRITEONCE,     "pintool",  "mrcs", "1",                "fraction of lines sampled for the miss ratio curves (SHARDS), bounds their memory");
+KNOB<UINT32> KnobSetSampling(KNOB_MODE_WRITEONCE,           "pintool",  "ss",   "1",                "simulate one set in this many (power of 2) at every level and extrapolate the statistics");
+KNOB<UINT64> KnobFastForward(KNOB_MODE_WRITEONCE,           "pintool",  "ff",   "0",                "time sampling: instructions run without instrumentation in every period");
+KNOB<UINT64> KnobWarmUp(KNOB_MODE_WRITEONCE,                "pintool",  "wu",   "0",                "time sampling: instructions simulated without statistics in every period, after the fast-forward");
+KNOB<UINT64> KnobDetailed(KNOB_MODE_WRITEONCE,              "pintool",  "di",   "0",                "time sampling: instructions simulated with statistics in every period -- 0 disables time sampling");
+KNOB<BOOL>   KnobPCProfile(KNOB_MODE_WRITEONCE,             "pintool",  "pc",   "0",                "attribute the hits, misses and evictions of every level to instruction addresses");
+KNOB<BOOL>   KnobCoalesce(KNOB_MODE_WRITEONCE,              "pintool",  "cl",   "1",                "simulate fetches once per line of a basic block and filter repeat data accesses to a line -- same statistics, 0 instruments every access");
+KNOB<UINT64> KnobInterval(KNOB_MODE_WRITEONCE,              "pintool",  "iv",   "0",                "snapshot the counters of a thread every this many of its accesses -- 0 disables the interval file");
 
 
 INT32 Usage()
@@ -30,50 +48,685 @@ INT32 Usage()
     return -1;
 }
 
-int num_threads = 0;
-
-CACHE_STATS CountAccess[MAX_THREADS][3];
 PIN_LOCK lock;
 
 
-VOID LoadMulti(ADDRINT addr, UINT32 size, ADDRINT instAddr,THREADID threadid)
+bool UseGlobalLock = false;
+
+//==============================================================
+// Interval statistics: every N accesses of a thread its counters are
+// copied into a record, and a writer thread appends the records to the
+// interval file so the application never waits on the file.
+//==============================================================
+#define INTERVAL_QUEUE_SIZE 1024 // Outstanding snapshots (power of 2)
+#define INTERVAL_CACHES 4        // L1I, then the data levels
+
+struct INTERVAL_RECORD
 {
-    PIN_GetLock(&lock, threadid+1);
+    UINT32 _tid;
+    UINT64 _interval;
+    CACHE_STATS _accesses; // Of the thread, up to the snapshot
+    CACHE_STATS _counts[INTERVAL_CACHES][ACCESS_TYPE_NUM][OPERATION_NUM];
+};
+
+UINT64 IntervalAccesses = 0;
+FILE *IntervalFile = NULL;   // Opened with the main executable, named after it
+string IntervalFileName;
+CONSUMER_THREAD<INTERVAL_RECORD> IntervalWriter;
 
-    CountAccess[threadid][ACCESS_TYPE_LOAD]++;
-    Hierarchies[0].dl1[threadid].Access(addr, size, ACCESS_TYPE_LOAD, instAddr);
 
-    PIN_ReleaseLock(&lock);
+// Counters are cumulative, consecutive intervals of a thread give the
+// behavior of each phase. The shared level counts all threads.
+VOID WriteInterval(INTERVAL_RECORD *record)
+{
+    static const char *cacheNames[INTERVAL_CACHES] = { "L1I", "L1D", "L2", "L3" };
+
+    for (UINT32 i=0; i<=Levels && i<INTERVAL_CACHES; i++){
+        fprintf(IntervalFile,"%u;%llu;%llu;%s;",record->_tid, (CACHE_STATS) record->_interval, record->_accesses, cacheNames[i]);
+        for (UINT32 type=0; type<ACCESS_TYPE_NUM; type++)
+            fprintf(IntervalFile,"%llu;%llu;",record->_counts[i][type][OPERATION_HIT], record->_counts[i][type][OPERATION_MISS]);
+        fprintf(IntervalFile,"\n");
+    }
+
+    delete record;
 }
 
 
-VOID StoreMulti(ADDRINT addr, UINT32 size, ADDRINT instAddr,THREADID threadid)
+VOID SnapshotInterval(THREAD_HIERARCHY *hierarchy, THREADID threadid)
+{
+    INTERVAL_RECORD *record = new INTERVAL_RECORD;
+    UINT32 i, type;
+
+    memset(record, 0, sizeof(*record));
+    record->_tid = threadid;
+    record->_interval = hierarchy->Intervals++;
+    for (type=0; type<ACCESS_TYPE_NUM; type++)
+        record->_accesses += hierarchy->CountAccess[type];
+
+    for (i=0; i<=Levels && i<INTERVAL_CACHES; i++){
+        CACHE_BASE *cache = (i == 0) ? &hierarchy->il1 : DataCache(i-1, hierarchy);
+        for (type=0; type<ACCESS_TYPE_NUM; type++){
+            record->_counts[i][type][OPERATION_HIT] = cache->Hits((ACCESS_TYPE) type);
+            record->_counts[i][type][OPERATION_MISS] = cache->Misses((ACCESS_TYPE) type);
+        }
+    }
+
+    hierarchy->IntervalLeft = IntervalAccesses;
+    IntervalWriter.Push(record, threadid);
+}
+
+
+VOID IntervalPrepareForFini(VOID *v)
+{
+    IntervalWriter.Stop();
+}
+
+
+// Before the first access, so the writer never sees a record before the file
+VOID OpenIntervals(string filename)
 {
-    PIN_GetLock(&lock, threadid+1);
+    IntervalFileName = filename;
+    IntervalFile = fopen(filename.c_str(), "w");
+    if (IntervalFile == NULL)
+        PIN_ERROR("Could not open the interval file " + filename + "\n");
 
-    CountAccess[threadid][ACCESS_TYPE_STORE]++;
-    Hierarchies[0].dl1[threadid].Access(addr, size, ACCESS_TYPE_STORE, instAddr);
+    fprintf(IntervalFile,"#TID;INTERVAL;ACCESSES;CACHE;INSTRUCTION_HITS;INSTRUCTION_MISSES;LOAD_HITS;LOAD_MISSES;STORE_HITS;STORE_MISSES;");
+    fprintf(IntervalFile,"\n");
+}
+
+
+VOID StartIntervals()
+{
+    IntervalAccesses = KnobInterval;
+
+    if (!IntervalWriter.Start(INTERVAL_QUEUE_SIZE, WriteInterval))
+        PIN_ERROR("Could not spawn the interval writer\n");
 
-    PIN_ReleaseLock(&lock);
+    PIN_AddPrepareForFiniFunction(IntervalPrepareForFini, 0);
+}
+
+
+//==============================================================
+// Coalescing: instruction fetches are simulated once per line of a basic
+// block, and an inlined filter counts the loads and stores that repeat the
+// last line of the thread as hits. Only accesses known to hit the most
+// recently used line of a private L1 are skipped, which changes nothing
+// but the hit counters, so the statistics are those of simulating every
+// access.
+//==============================================================
+bool CoalesceFetches = false;
+bool LineFilter = false;
+REG FilterReg;          // Tool register holding the THREAD_HIERARCHY of the thread
+
+
+// Private levels are only touched by their own thread, and the shared LLC
+// locks its own set shards, so the global lock is kept only on request.
+static inline VOID SimulateAccess(THREAD_HIERARCHY *hierarchy, ADDRINT addr, UINT32 size, ACCESS_TYPE accessType, ADDRINT instAddr, THREADID threadid, bool warmUp)
+{
+    CACHE_BASE *cache = (accessType == ACCESS_TYPE_INSTRUCTION) ? &hierarchy->il1 : &hierarchy->dl1[0];
+    OPERATION op;
+
+    if (UseGlobalLock)
+        PIN_GetLock(&lock, threadid+1);
+
+    if (warmUp){
+        cache->WarmUp(addr, size, accessType, instAddr);
+        hierarchy->FilterLine = NO_FILTER_LINE;
+    }
+    else{
+        hierarchy->CountAccess[accessType]++;
+        op = cache->Access(addr, size, accessType, instAddr);
+
+        if (LineFilter && accessType != ACCESS_TYPE_INSTRUCTION)
+            ArmFilter(hierarchy, cache, addr, size, accessType, op);
+
+        if (IntervalAccesses){
+            hierarchy->IntervalLeft -= 1 + FlushFilter(hierarchy);
+            if (hierarchy->IntervalLeft <= 0)
+                SnapshotInterval(hierarchy, threadid);
+        }
+    }
+
+    if (UseGlobalLock)
+        PIN_ReleaseLock(&lock);
+}
+
+
+VOID LoadMulti(ADDRINT addr, UINT32 size, ADDRINT instAddr,THREADID threadid)
+{
+    SimulateAccess(Threads.Get(threadid), addr, size, ACCESS_TYPE_LOAD, instAddr, threadid, false);
+}
+
+
+VOID StoreMulti(ADDRINT addr, UINT32 size, ADDRINT instAddr,THREADID threadid)
+{
+    SimulateAccess(Threads.Get(threadid), addr, size, ACCESS_TYPE_STORE, instAddr, threadid, false);
 }
 
 
 VOID LoadInstructionMulti(ADDRINT addr, UINT32 size, ADDRINT instAddr,THREADID threadid)
 {
-    PIN_GetLock(&lock, threadid+1);
+    SimulateAccess(Threads.Get(threadid), addr, size, ACCESS_TYPE_INSTRUCTION, instAddr, threadid, false);
+}
+
+
+VOID WarmUpLoad(ADDRINT addr, UINT32 size, ADDRINT instAddr,THREADID threadid)
+{
+    SimulateAccess(Threads.Get(threadid), addr, size, ACCESS_TYPE_LOAD, instAddr, threadid, true);
+}
+
+
+VOID WarmUpStore(ADDRINT addr, UINT32 size, ADDRINT instAddr,THREADID threadid)
+{
+    SimulateAccess(Threads.Get(threadid), addr, size, ACCESS_TYPE_STORE, instAddr, threadid, true);
+}
+
+
+VOID WarmUpInstruction(ADDRINT addr, UINT32 size, ADDRINT instAddr,THREADID threadid)
+{
+    SimulateAccess(Threads.Get(threadid), addr, size, ACCESS_TYPE_INSTRUCTION, instAddr, threadid, true);
+}
+
+
+// Inlined before the loads and stores: returns whether the access needs
+// the full walk, or counts a hit if it repeats the filtered line.
+ADDRINT FilterLoad(THREAD_HIERARCHY *hierarchy, ADDRINT addr, UINT32 size)
+{
+    return !FilterRepeat(hierarchy, addr, size, ACCESS_TYPE_LOAD);
+}
+
+
+ADDRINT FilterStore(THREAD_HIERARCHY *hierarchy, ADDRINT addr, UINT32 size)
+{
+    return !FilterRepeat(hierarchy, addr, size, ACCESS_TYPE_STORE);
+}
+
+
+// Fetches of a run of instructions of a basic block in the same line: the
+// first one is simulated and leaves the line most recently used in the
+// L1I, so the count-1 others are hits.
+static inline VOID FetchLine(ADDRINT addr, UINT32 size, UINT32 count, THREADID threadid, bool warmUp)
+{
+    THREAD_HIERARCHY *hierarchy = Threads.Get(threadid);
+
+    SimulateAccess(hierarchy, addr, size, ACCESS_TYPE_INSTRUCTION, addr, threadid, warmUp);
+    if (warmUp || count == 1)
+        return;
+
+    CountLineHits(hierarchy, addr, count - 1);
+    if (IntervalAccesses)
+        hierarchy->IntervalLeft -= count - 1;
+}
+
+
+VOID InstructionLine(ADDRINT addr, UINT32 size, UINT32 count, THREADID threadid)
+{
+    FetchLine(addr, size, count, threadid, false);
+}
+
+
+VOID WarmUpInstructionLine(ADDRINT addr, UINT32 size, UINT32 count, THREADID threadid)
+{
+    FetchLine(addr, size, count, threadid, true);
+}
+
+//==============================================================
+// Time sampling: every period runs a fast-forward, a warm-up and a detailed
+// phase of a given number of instructions. Fast-forward code carries no
+// simulation instrumentation at all, only a count of instructions per
+// basic block, and the code cache is flushed at every phase change so
+// that Instruction() instruments the code again for the new phase.
+//==============================================================
+#define SAMPLING_QUANTUM 4096 // Instructions a thread counts before charging them to the phase
+
+INT64 PhaseLeft = 0; // Instructions left in the current phase
+PIN_LOCK phaseLock;
+
+
+// Moves on to the next phase of nonzero length
+VOID NextPhase()
+{
+    UINT32 phase = Sampling._phase;
+
+    do {
+        phase = (phase + 1) % SAMPLING_PHASE_NUM;
+    } while (Sampling._length[phase] == 0);
+
+    Sampling._phase = phase;
+    PhaseLeft = Sampling._length[phase];
+}
+
+
+ADDRINT CountInstructions(UINT32 numIns, THREADID threadid)
+{
+    THREAD_HIERARCHY *hierarchy = Threads.Get(threadid);
+
+    hierarchy->Instructions += numIns;
+    return hierarchy->Instructions >= SAMPLING_QUANTUM;
+}
+
+
+// Charges the instructions of a thread to the current phase, which ends
+// once it ran its length: phases are as precise as a quantum per thread.
+VOID ChargeInstructions(THREADID threadid)
+{
+    THREAD_HIERARCHY *hierarchy = Threads.Get(threadid);
+    UINT32 phase;
+
+    PIN_GetLock(&phaseLock, threadid+1);
+
+    phase = Sampling._phase;
+    Sampling._instructions[phase] += hierarchy->Instructions;
+    PhaseLeft -= hierarchy->Instructions;
+    hierarchy->Instructions = 0;
+
+    if (PhaseLeft <= 0){
+        NextPhase();
+        if (Sampling._phase != phase)
+            PIN_RemoveInstrumentation();
+    }
+
+    PIN_ReleaseLock(&phaseLock);
+}
+
+
+// Instructions of the threads that ended within a quantum
+VOID ChargeRemainingInstructions()
+{
+    for (UINT32 tid=0; tid<Threads.Size(); tid++){
+        THREAD_HIERARCHY *hierarchy = Threads.Get(tid);
+        if (hierarchy == NULL) continue;
+
+        Sampling._instructions[Sampling._phase] += hierarchy->Instructions;
+        hierarchy->Instructions = 0;
+    }
+}
+
+
+VOID CountTrace(TRACE trace, VOID *v)
+{
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)){
+        BBL_InsertIfCall(bbl, IPOINT_BEFORE, (AFUNPTR) CountInstructions,
+            IARG_UINT32, BBL_NumIns(bbl),
+            IARG_THREAD_ID,
+            IARG_END);
+        BBL_InsertThenCall(bbl, IPOINT_BEFORE, (AFUNPTR) ChargeInstructions,
+            IARG_THREAD_ID,
+            IARG_END);
+    }
+}
+
+
+VOID StartTimeSampling()
+{
+    Sampling._length[SAMPLING_FAST_FORWARD] = KnobFastForward;
+    Sampling._length[SAMPLING_WARM_UP] = KnobWarmUp;
+    Sampling._length[SAMPLING_DETAILED] = KnobDetailed;
 
-    CountAccess[threadid][ACCESS_TYPE_INSTRUCTION]++;
-    Hierarchies[0].il1[threadid].Access(addr, size, ACCESS_TYPE_INSTRUCTION, instAddr);
+    // Periods start with the fast-forward
+    PIN_InitLock(&phaseLock);
+    Sampling._phase = SAMPLING_DETAILED;
+    NextPhase();
 
-    PIN_ReleaseLock(&lock);
+    TRACE_AddInstrumentFunction(CountTrace, 0);
 }
 
+//==============================================================
+// Buffered mode: the instrumentation only fills a per-thread buffer, full
+// buffers are simulated by worker threads while the application goes on.
+//==============================================================
+#define BATCH_QUEUE_SIZE 64 // Outstanding batches per worker (power of 2)
+
+BUFFER_ID AccessBuffer;
+UINT32 NumWorkers = 0;
+CONSUMER_THREAD<ACCESS_BATCH> *Workers;    // Threads map to a fixed worker
+LOCKFREE_QUEUE<ACCESS_BATCH> FreeBatches;  // Simulated batches, ready to be refilled
+
+
+// All records of a thread go through the same worker, in order, so the
+// private caches see exactly the sequence the inline mode would.
+VOID SimulateBatch(ACCESS_BATCH *batch)
+{
+    const THREADID threadid = batch->_tid;
+    THREAD_HIERARCHY *hierarchy = Threads.Get(threadid);
+    const ACCESS_RECORD *record = batch->_records;
+    const ACCESS_RECORD *end = record + batch->_count;
+
+    for (; record < end; record++)
+        SimulateAccess(hierarchy, record->_addr, record->_size, (ACCESS_TYPE)(record->_accessType & ~ACCESS_RECORD_WARM_UP),
+                       record->_pc, threadid, record->_accessType & ACCESS_RECORD_WARM_UP);
+}
+
+
+VOID SimulateAndRecycleBatch(ACCESS_BATCH *batch)
+{
+    SimulateBatch(batch);
+
+    if (!FreeBatches.Push(batch)){
+        PIN_DeallocateBuffer(AccessBuffer, batch->_records);
+        delete batch;
+    }
+}
+
+
+VOID * BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT *ctxt, VOID *buf, UINT64 numElements, VOID *v)
+{
+    ACCESS_BATCH *batch = FreeBatches.Pop();
+    VOID *next;
+
+    if (batch == NULL){
+        batch = new ACCESS_BATCH;
+        next = PIN_AllocateBuffer(id);
+    }
+    else{
+        next = batch->_records;
+    }
+
+    batch->_tid = tid;
+    batch->_count = numElements;
+    batch->_records = (ACCESS_RECORD *) buf;
+
+    Workers[tid % NumWorkers].Push(batch, tid);
+    return next;
+}
+
+
+// Batches flushed by exiting threads after the workers stopped.
+VOID DrainBatches()
+{
+    for (UINT32 i=0; i<NumWorkers; i++)
+        Workers[i].Drain();
+}
+
+
+VOID PrepareForFini(VOID *v)
+{
+    for (UINT32 i=0; i<NumWorkers; i++)
+        Workers[i].Stop();
+}
+
+
+VOID StartWorkers()
+{
+    UINT32 freeSize = BATCH_QUEUE_SIZE;
+
+    NumWorkers = KnobBufferWorkers;
+    if (NumWorkers == 0)
+        NumWorkers = 1;
+
+    AccessBuffer = PIN_DefineTraceBuffer(sizeof(ACCESS_RECORD), KnobBufferPages, BufferFull, 0);
+    if (AccessBuffer == BUFFER_ID_INVALID)
+        PIN_ERROR("Could not allocate the access buffer\n");
+
+    while (freeSize < BATCH_QUEUE_SIZE * NumWorkers)
+        freeSize <<= 1;
+
+    FreeBatches.Init(freeSize);
+    Workers = new CONSUMER_THREAD<ACCESS_BATCH>[NumWorkers];
+
+    // Back-pressure: a full worker queue stalls the application thread
+    for (UINT32 i=0; i<NumWorkers; i++){
+        if (!Workers[i].Start(BATCH_QUEUE_SIZE, SimulateAndRecycleBatch))
+            PIN_ERROR("Could not spawn a simulation worker\n");
+    }
+
+    PIN_AddPrepareForFiniFunction(PrepareForFini, 0);
+}
+
+
+//==============================================================
+// Capture mode: accesses are encoded into per-thread chunks, and a
+// writer thread streams the full chunks to the trace file. Every
+// TRACE_EPOCH_RECORDS accesses a thread draws a global sequence number, so
+// replay can interleave the threads roughly as they ran.
+//==============================================================
+#define TRACE_QUEUE_SIZE 256 // Outstanding chunks (power of 2)
+
+FILE *TraceFile = NULL;
+TLS_KEY TraceKey;
+UINT64 TraceSequence = 0;              // Next epoch of any thread
+CONSUMER_THREAD<UINT8> TraceWriter;    // Writes the sealed chunks in order
+LOCKFREE_QUEUE<UINT8> FreeChunks;      // Written chunks, ready to be refilled
+
+
+VOID WriteChunk(UINT8 *chunk)
+{
+    TRACE_CHUNK_HEADER header;
+
+    memcpy(&header, chunk, sizeof(header));
+    fwrite(chunk, 1, sizeof(header) + header._bytes, TraceFile);
+
+    if (!FreeChunks.Push(chunk))
+        delete [] chunk;
+}
+
+
+// Seals the current chunk of the thread and starts a new one.
+VOID FlushChunk(TRACE_ENCODER *encoder)
+{
+    UINT32 bytes;
+    UINT8 *chunk = encoder->Finish(bytes);
+    UINT8 *next = FreeChunks.Pop();
+
+    if (next == NULL)
+        next = new UINT8[TRACE_CHUNK_SIZE];
+
+    TraceWriter.Push(chunk, encoder->_tid);
+    encoder->Init(encoder->_tid, next);
+}
+
+
+static inline VOID TraceAccess(ADDRINT addr, UINT32 size, ACCESS_TYPE accessType, ADDRINT instAddr, THREADID threadid)
+{
+    TRACE_ENCODER *encoder = static_cast<TRACE_ENCODER *>(PIN_GetThreadData(TraceKey, threadid));
+
+    if (encoder->Full())
+        FlushChunk(encoder);
+    if (encoder->EpochDue())
+        encoder->Epoch(__sync_fetch_and_add(&TraceSequence, 1));
+    encoder->Append(addr, size, accessType, instAddr);
+}
+
+
+VOID TraceLoad(ADDRINT addr, UINT32 size, ADDRINT instAddr, THREADID threadid)
+{
+    TraceAccess(addr, size, ACCESS_TYPE_LOAD, instAddr, threadid);
+}
+
+
+VOID TraceStore(ADDRINT addr, UINT32 size, ADDRINT instAddr, THREADID threadid)
+{
+    TraceAccess(addr, size, ACCESS_TYPE_STORE, instAddr, threadid);
+}
+
+
+VOID TraceInstruction(ADDRINT addr, UINT32 size, ADDRINT instAddr, THREADID threadid)
+{
+    TraceAccess(addr, size, ACCESS_TYPE_INSTRUCTION, instAddr, threadid);
+}
+
+
+VOID TraceThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    TRACE_ENCODER *encoder = new TRACE_ENCODER;
+    UINT8 *chunk = FreeChunks.Pop();
+
+    if (chunk == NULL)
+        chunk = new UINT8[TRACE_CHUNK_SIZE];
+
+    encoder->Init(tid, chunk);
+    PIN_SetThreadData(TraceKey, encoder, tid);
+}
+
+
+VOID TraceThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v)
+{
+    TRACE_ENCODER *encoder = static_cast<TRACE_ENCODER *>(PIN_GetThreadData(TraceKey, tid));
+
+    if (!encoder->Empty())
+        FlushChunk(encoder);
+
+    delete [] encoder->_buffer;
+    delete encoder;
+    PIN_SetThreadData(TraceKey, NULL, tid);
+}
+
+
+VOID TracePrepareForFini(VOID *v)
+{
+    TraceWriter.Stop();
+}
+
+
+VOID StartTrace()
+{
+    TRACE_FILE_HEADER header;
+
+    TraceFile = fopen(KnobTraceFile.Value().c_str(), "wb");
+    if (TraceFile == NULL)
+        PIN_ERROR("Could not open the trace file " + KnobTraceFile.Value() + "\n");
+
+    memcpy(header._magic, TRACE_MAGIC, sizeof(header._magic));
+    header._version = TRACE_VERSION;
+    header._flags = (KnobTrackLoads ? TRACE_TRACKS_LOADS : 0) | (KnobTrackStores ? TRACE_TRACKS_STORES : 0) | (KnobTrackInstructions ? TRACE_TRACKS_INSTRUCTIONS : 0);
+    fwrite(&header, sizeof(header), 1, TraceFile);
+
+    TraceKey = PIN_CreateThreadDataKey(0);
+    FreeChunks.Init(TRACE_QUEUE_SIZE);
+
+    if (!TraceWriter.Start(TRACE_QUEUE_SIZE, WriteChunk))
+        PIN_ERROR("Could not spawn the trace writer\n");
+
+    PIN_AddThreadStartFunction(TraceThreadStart, 0);
+    PIN_AddThreadFiniFunction(TraceThreadFini, 0);
+    PIN_AddPrepareForFiniFunction(TracePrepareForFini, 0);
+}
+
+
+VOID InstructionBuffered(INS ins, UINT32 warmUp)
+{
+    if( KnobTrackInstructions )
+    {
+        INS_InsertFillBuffer(ins, IPOINT_BEFORE, AccessBuffer,
+            IARG_INST_PTR, offsetof(ACCESS_RECORD, _addr),
+            IARG_UINT32, INS_Size(ins), offsetof(ACCESS_RECORD, _size),
+            IARG_INST_PTR, offsetof(ACCESS_RECORD, _pc),
+            IARG_UINT32, ACCESS_TYPE_INSTRUCTION | warmUp, offsetof(ACCESS_RECORD, _accessType),
+            IARG_END);
+    }
+
+    if (INS_IsMemoryRead(ins) && KnobTrackLoads)
+    {
+        INS_InsertFillBufferPredicated(ins, IPOINT_BEFORE, AccessBuffer,
+            IARG_MEMORYREAD_EA, offsetof(ACCESS_RECORD, _addr),
+            IARG_MEMORYREAD_SIZE, offsetof(ACCESS_RECORD, _size),
+            IARG_INST_PTR, offsetof(ACCESS_RECORD, _pc),
+            IARG_UINT32, ACCESS_TYPE_LOAD | warmUp, offsetof(ACCESS_RECORD, _accessType),
+            IARG_END);
+    }
+
+    if ( INS_IsMemoryWrite(ins) && KnobTrackStores)
+    {
+        INS_InsertFillBufferPredicated(ins, IPOINT_BEFORE, AccessBuffer,
+            IARG_MEMORYWRITE_EA, offsetof(ACCESS_RECORD, _addr),
+            IARG_MEMORYWRITE_SIZE, offsetof(ACCESS_RECORD, _size),
+            IARG_INST_PTR, offsetof(ACCESS_RECORD, _pc),
+            IARG_UINT32, ACCESS_TYPE_STORE | warmUp, offsetof(ACCESS_RECORD, _accessType),
+            IARG_END);
+    }
+}
+
+
+VOID InsertFetch(INS ins, UINT32 count, AFUNPTR fetchFn)
+{
+    // Before the data accesses of the instruction, as in Instruction()
+    INS_InsertCall(ins, IPOINT_BEFORE, fetchFn,
+        IARG_CALL_ORDER, CALL_ORDER_FIRST,
+        IARG_INST_PTR,
+        IARG_UINT32, INS_Size(ins),
+        IARG_UINT32, count,
+        IARG_THREAD_ID,
+        IARG_END);
+}
+
+
+// Instruction fetches with coalescing: one call per run of instructions of
+// a basic block in the same line.
+VOID InstructionTrace(TRACE trace, VOID *v)
+{
+    AFUNPTR fetchFn = (AFUNPTR) InstructionLine;
+
+    // Left uninstrumented until the next phase, see ChargeInstructions
+    if( Sampling._phase == SAMPLING_FAST_FORWARD )
+        return;
+
+    if( Sampling._phase == SAMPLING_WARM_UP )
+        fetchFn = (AFUNPTR) WarmUpInstructionLine;
+
+    vector<INS> instructions;
+    vector<FETCH_INS> fetches;
+    vector<UINT32> runs;
+
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)){
+        instructions.clear();
+        fetches.clear();
+
+        for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)){
+            FETCH_INS fetch;
+
+            fetch._addr = INS_Address(ins);
+            fetch._size = INS_Size(ins);
+            fetch._rep = INS_HasRealRep(ins);
+            instructions.push_back(ins);
+            fetches.push_back(fetch);
+        }
+
+        runs.resize(fetches.size());
+        FetchRuns(&fetches[0], fetches.size(), &runs[0]);
+
+        for (UINT32 k = 0; k < instructions.size(); k++){
+            if (runs[k] > 0)
+                InsertFetch(instructions[k], runs[k], fetchFn);
+        }
+    }
+}
+
+
 VOID Instruction(INS ins, void * v)
 {
+    AFUNPTR instructionFn = (AFUNPTR) LoadInstructionMulti;
+    AFUNPTR loadFn = (AFUNPTR) LoadMulti;
+    AFUNPTR storeFn = (AFUNPTR) StoreMulti;
+    const bool warmUp = Sampling._phase == SAMPLING_WARM_UP;
+
+    // Left uninstrumented until the next phase, see ChargeInstructions
+    if( Sampling._phase == SAMPLING_FAST_FORWARD )
+        return;
+
+    if( KnobBuffered && TraceFile == NULL )
+    {
+        InstructionBuffered(ins, warmUp ? ACCESS_RECORD_WARM_UP : 0);
+        return;
+    }
+
+    if( warmUp )
+    {
+        instructionFn = (AFUNPTR) WarmUpInstruction;
+        loadFn = (AFUNPTR) WarmUpLoad;
+        storeFn = (AFUNPTR) WarmUpStore;
+    }
+
+    if( TraceFile != NULL )
+    {
+        instructionFn = (AFUNPTR) TraceInstruction;
+        loadFn = (AFUNPTR) TraceLoad;
+        storeFn = (AFUNPTR) TraceStore;
+    }
+
     // Track the Instructions and send to the Instruction Cache
-    if( KnobTrackInstructions )
+    if( KnobTrackInstructions && !CoalesceFetches )
     {
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)LoadInstructionMulti,
+        INS_InsertCall(ins, IPOINT_BEFORE, instructionFn,
             IARG_INST_PTR,
             IARG_UINT32,
             INS_Size(ins),
@@ -83,11 +736,46 @@ VOID Instruction(INS ins, void * v)
     }
 
 
+    // Repeats of the last line are counted inline, the rest goes to the Data Cache
+    if( LineFilter && !warmUp )
+    {
+        if (INS_IsMemoryRead(ins) && KnobTrackLoads)
+        {
+            INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR) FilterLoad,
+                IARG_REG_VALUE, FilterReg,
+                IARG_MEMORYREAD_EA,
+                IARG_MEMORYREAD_SIZE,
+                IARG_END);
+            INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, loadFn,
+                IARG_MEMORYREAD_EA,
+                IARG_MEMORYREAD_SIZE,
+                IARG_INST_PTR,
+                IARG_THREAD_ID,
+                IARG_END);
+        }
+
+        if (INS_IsMemoryWrite(ins) && KnobTrackStores)
+        {
+            INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR) FilterStore,
+                IARG_REG_VALUE, FilterReg,
+                IARG_MEMORYWRITE_EA,
+                IARG_MEMORYWRITE_SIZE,
+                IARG_END);
+            INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, storeFn,
+                IARG_MEMORYWRITE_EA,
+                IARG_MEMORYWRITE_SIZE,
+                IARG_INST_PTR,
+                IARG_THREAD_ID,
+                IARG_END);
+        }
+        return;
+    }
+
     // Track the Loads and Stores and send to the Data Cache
     if (INS_IsMemoryRead(ins) && KnobTrackLoads)
     {
         INS_InsertPredicatedCall(
-            ins, IPOINT_BEFORE,  (AFUNPTR) LoadMulti,
+            ins, IPOINT_BEFORE,  loadFn,
             IARG_MEMORYREAD_EA,
             IARG_MEMORYREAD_SIZE,
             IARG_INST_PTR,
@@ -98,7 +786,7 @@ VOID Instruction(INS ins, void * v)
     if ( INS_IsMemoryWrite(ins) && KnobTrackStores)
     {
         INS_InsertPredicatedCall(
-            ins, IPOINT_BEFORE,  (AFUNPTR) StoreMulti,
+            ins, IPOINT_BEFORE,  storeFn,
             IARG_MEMORYWRITE_EA,
             IARG_MEMORYWRITE_SIZE,
             IARG_INST_PTR,
@@ -109,111 +797,145 @@ VOID Instruction(INS ins, void * v)
 
 string img_name;
 
+// Images and routines as they were loaded, to name the PCs of the per-PC
+// profile at the end even if their image was unloaded since
+struct SYMBOL
+{
+    ADDRINT _low;
+    ADDRINT _high;
+    string _name;
+};
+
+std::map<ADDRINT, SYMBOL> Images;   // By low address
+std::map<ADDRINT, SYMBOL> Routines; // By start address
+
+
+VOID RecordSymbols(IMG img)
+{
+    SYMBOL image;
+
+    image._low = IMG_LowAddress(img);
+    image._high = IMG_HighAddress(img);
+    image._name = basename(IMG_Name(img).c_str());
+    Images[image._low] = image;
+
+    for (SEC sec = IMG_SecHead(img); SEC_Valid(sec); sec = SEC_Next(sec)){
+        for (RTN rtn = SEC_RtnHead(sec); RTN_Valid(rtn); rtn = RTN_Next(rtn)){
+            SYMBOL routine;
+            routine._low = RTN_Address(rtn);
+            routine._high = routine._low + RTN_Size(rtn);
+            routine._name = RTN_Name(rtn);
+            Routines[routine._low] = routine;
+        }
+    }
+}
+
+
+// Entry of a map by low address that contains addr, or NULL
+static const SYMBOL *FindSymbol(std::map<ADDRINT, SYMBOL> &symbols, ADDRINT addr)
+{
+    std::map<ADDRINT, SYMBOL>::iterator it = symbols.upper_bound(addr);
+
+    if (it == symbols.begin())
+        return NULL;
+    --it;
+    return addr < it->second._high ? &it->second : NULL;
+}
+
+
+string SymbolizePC(ADDRINT pc)
+{
+    const SYMBOL *image = FindSymbol(Images, pc);
+    const SYMBOL *routine = FindSymbol(Routines, pc);
+    string name = image ? image->_name : "";
+    char offset[32];
+
+    if (routine == NULL)
+        return name + ";";
+
+    snprintf(offset, sizeof(offset), "+0x%llx", (CACHE_STATS)(pc - routine->_low));
+    return name + ";" + routine->_name + offset;
+}
+
+
 VOID binName(IMG img, VOID *v)
 {
-    if (IMG_IsMainExecutable(img))
+    if (IMG_IsMainExecutable(img)){
         img_name = basename(IMG_Name(img).c_str());
+        if( IntervalAccesses )
+            OpenIntervals(img_name + ".intervals.out");
+    }
+
+    if( KnobPCProfile )
+        RecordSymbols(img);
 }
 
 
 VOID Fini(int code, VOID * v)
 {
-    CACHE_STATS TID=0; // Thread Id Iterator
-    CACHE_STATS LVL=0; // Cache Level Iterator
-
-    CACHE_STATS Max_Threads = num_threads;
+    if( TraceFile != NULL ){
+        TraceWriter.Drain();
+        fclose(TraceFile);
+        cout << "Wrote " << KnobTraceFile.Value() << endl;
+        return;
+    }
 
-    string filename = img_name+"."+to_string(Hierarchies[0].dl1[0].GetCacheSize()/KILO)+"KB"+to_string(Hierarchies[0].dl1[0].GetLineSize())+"B" + to_string(Levels) + "L.out";
+    if( KnobBuffered )
+        DrainBatches();
 
-    FILE *out = fopen(filename.c_str(), "w");
+    if( Sampling.TimeSampling() )
+        ChargeRemainingInstructions();
 
-    for (LVL=0 ; LVL<Levels; LVL++){
+    if( LineFilter )
+        FlushFilters();
 
-        if (LVL<Levels-1) Max_Threads = num_threads;
-        else Max_Threads = 1;
+    string filename = img_name+"."+to_string(Hierarchies[0].params_dl1._cacheSize)+"KB"+to_string(Hierarchies[0].params_dl1._lineSize)+"B" + to_string(Levels) + "L.out";
 
-        //=====================================================================
-        fprintf(out,"#CACHE LEVEL %llu\n",LVL+1);
-        //=====================================================================
+    FILE *out = fopen(filename.c_str(), "w");
 
-        if( KnobTrackLoads ||  KnobTrackStores){
-            //=====================================================================
-            fprintf(out,"#DATA CACHE - DESCRIPTION\n");
-            //=====================================================================
-            fprintf(out,"#L%llu_DATA_CACHE;SIZE;LINE_SIZE;ASSOCIATIVITY;WRITE_ALLOCATE;",LVL+1);
-            fprintf(out,"\n");
-            fprintf(out,"%d;%d;%d;%d;%d;",0, Hierarchies[LVL].dl1[0].GetCacheSize(), Hierarchies[LVL].dl1[0].GetLineSize(), Hierarchies[LVL].dl1[0].GetAssociativity(), Hierarchies[LVL].dl1[0].GetWriteAllocate());
-            fprintf(out,"\n");
-            fprintf(out,"\n");
-        }
-        if( KnobTrackInstructions && LVL==0 ){
-            //=====================================================================
-            fprintf(out,"#INST CACHE - DESCRIPTION\n");
-            //=====================================================================
-            fprintf(out,"#L%llu_INST_CACHE;SIZE;LINE_SIZE;ASSOCIATIVITY;",LVL+1);
-            fprintf(out,"\n");
-            fprintf(out,"%d;%d;%d;%d;",0, Hierarchies[LVL].il1[0].GetCacheSize(), Hierarchies[LVL].il1[0].GetLineSize(), Hierarchies[LVL].il1[0].GetAssociativity());
-            fprintf(out,"\n");
-            fprintf(out,"\n");
-        }
+    WriteCacheReport(out, KnobTrackLoads || KnobTrackStores, KnobTrackInstructions);
 
+    fclose(out);
+    cout << "Wrote " << filename << endl;
 
-        //=====================================================================
-        fprintf(out,"#DATA + INST CACHE - ACCESS CALL COUNTER\n");
-        //=====================================================================
-        fprintf(out,"#L%llu_DATA_CACHE;INSTRUCTIONS;LOAD;STORE;",LVL+1);
-        fprintf(out,"\n");
-        for (TID=0; TID<Max_Threads; TID++){
-            fprintf(out,"%llu;%llu;%llu;%llu;",TID, CountAccess[TID][ACCESS_TYPE_INSTRUCTION],CountAccess[TID][ACCESS_TYPE_LOAD],CountAccess[TID][ACCESS_TYPE_STORE]);
-            fprintf(out,"\n");
-        }
-        fprintf(out,"\n");
-
-
-        if( KnobTrackLoads ||  KnobTrackStores){
-            //=====================================================================
-            fprintf(out,"#DATA CACHE - MISS / HIT PROFILE\n");
-            //=====================================================================
-            fprintf(out,"#L%llu_DATA_CACHE;TOTAL_ACCESS;TOTAL_HITS;TOTAL_MISSES;",LVL+1);
-            fprintf(out,"LOAD_ACCESSES;LOAD_HIT;LOAD_MISSES;");
-            fprintf(out,"WRITE_ACCESES;WRITE_HIT;WRITE_MISS;");
-            fprintf(out,"EVICTED_LINES;FLUSHED_LINES;UNUSED_LINES;TOTAL_COLD_START_MISSES;");
-            fprintf(out,"\n");
-            for (TID=0; TID<Max_Threads; TID++){
-                fprintf(out,"%llu;%llu;%llu;%llu;",TID,Hierarchies[LVL].dl1[TID].Accesses(), Hierarchies[LVL].dl1[TID].Hits(),Hierarchies[LVL].dl1[TID].Misses());
-                fprintf(out,"%llu;%llu;%llu;",Hierarchies[LVL].dl1[TID].Accesses(ACCESS_TYPE_LOAD), Hierarchies[LVL].dl1[TID].Hits(ACCESS_TYPE_LOAD),Hierarchies[LVL].dl1[TID].Misses(ACCESS_TYPE_LOAD));
-                fprintf(out,"%llu;%llu;%llu;",Hierarchies[LVL].dl1[TID].Accesses(ACCESS_TYPE_STORE),Hierarchies[LVL].dl1[TID].Hits(ACCESS_TYPE_STORE),Hierarchies[LVL].dl1[TID].Misses(ACCESS_TYPE_STORE));
-                fprintf(out,"%llu;%llu;%llu;%llu;",Hierarchies[LVL].dl1[TID].EvictedLines(),Hierarchies[LVL].dl1[TID].FlushedLines(),Hierarchies[LVL].dl1[TID].UnusedLines(), Hierarchies[LVL].dl1[TID].ColdStart());
-                fprintf(out,"\n");
-            }
-            fprintf(out,"\n");
+    if( KnobMissRatioCurves ){
+        filename = img_name + ".mrc.out";
+        out = fopen(filename.c_str(), "w");
+        WriteMissRatioCurves(out, KnobTrackInstructions);
+        fclose(out);
+        cout << "Wrote " << filename << endl;
+    }
 
-        }
-        if( KnobTrackInstructions && LVL==0){
-            //=====================================================================
-            fprintf(out,"#INST CACHE - MISS / HIT PROFILE\n");
-            //=====================================================================
-            fprintf(out,"#L%llu_INST_CACHE;TOTAL_ACCESS;TOTAL_HITS;TOTAL_MISSES;",LVL+1);
-            fprintf(out,"INSTRUCTION_ACCESSES;INSTRUCTION_HIT;INSTRUCTION_MISSES;");
-            fprintf(out,"EVICTED_LINES;FLUSHED_LINES;UNUSED_LINES;TOTAL_COLD_START_MISSES;");
-            fprintf(out,"\n");
-            for (TID=0; TID<Max_Threads; TID++){
-                fprintf(out,"%llu;%llu;%llu;%llu;",TID,Hierarchies[LVL].il1[TID].Accesses(), Hierarchies[LVL].il1[TID].Hits(),Hierarchies[LVL].il1[TID].Misses());
-                fprintf(out,"%llu;%llu;%llu;",Hierarchies[LVL].il1[TID].Accesses(ACCESS_TYPE_INSTRUCTION), Hierarchies[LVL].il1[TID].Hits(ACCESS_TYPE_INSTRUCTION),Hierarchies[LVL].il1[TID].Misses(ACCESS_TYPE_INSTRUCTION));
-                fprintf(out,"%llu;%llu;%llu;%llu;",Hierarchies[LVL].il1[TID].EvictedLines(),Hierarchies[LVL].il1[TID].FlushedLines(),Hierarchies[LVL].il1[TID].UnusedLines(), Hierarchies[LVL].il1[TID].ColdStart());
-                fprintf(out,"\n");
-            }
-            fprintf(out,"\n");
-        }
+    if( KnobPCProfile ){
+        filename = img_name + ".pc.out";
+        out = fopen(filename.c_str(), "w");
+        WritePCProfiles(out, KnobTrackInstructions, SymbolizePC);
+        fclose(out);
+        cout << "Wrote " << filename << endl;
+    }
 
+    if( IntervalFile != NULL ){
+        IntervalWriter.Drain();
+        fclose(IntervalFile);
+        cout << "Wrote " << IntervalFileName << endl;
     }
-    fclose(out);
-    cout << "Wrote " << filename << endl;
 }
 
 VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
 {
-    __sync_add_and_fetch(&num_threads, 1);
+    // The caches are built here, so memory follows the actual thread count
+    if( TraceFile == NULL ){
+        THREAD_HIERARCHY *hierarchy = Threads.Get(tid);
+
+        // A reused id continues the hierarchy of the exited thread
+        if( hierarchy == NULL ){
+            hierarchy = AddThreadHierarchy(tid);
+            hierarchy->IntervalLeft = IntervalAccesses;
+        }
+        hierarchy->FilterLine = NO_FILTER_LINE;
+        if( LineFilter )
+            PIN_SetContextReg(ctxt, FilterReg, (ADDRINT) hierarchy);
+    }
 }
 
 int main(int argc, char *argv[])
@@ -225,14 +947,54 @@ int main(int argc, char *argv[])
         return Usage();
     }
 
-    for (UINT32 i=0; i<MAX_THREADS; i++){
-        for (UINT32 j=0; j<3; j++){
-            CountAccess[i][j] = 0;
-        }
-    }
+    InitCacheParams();
+
+    Sampling._setSampling = KnobSetSampling;
+    if( Sampling._setSampling == 0 || !IsPower2(Sampling._setSampling) )
+        PIN_ERROR("-ss must be a power of 2\n");
+    if( KnobDetailed > 0 && !KnobTraceFile.Value().empty() )
+        PIN_ERROR("Time sampling does not apply to trace capture\n");
+    if( !KnobTraceFile.Value().empty() && (KnobMissRatioCurves || KnobPCProfile || Sampling._setSampling > 1) )
+        PIN_ERROR("-mrc, -pc and -ss do not apply to trace capture, pass them to cache_replay\n");
+    if( KnobDetailed == 0 && (KnobFastForward > 0 || KnobWarmUp > 0) )
+        PIN_ERROR("-ff and -wu need a detailed phase, set -di\n");
 
     InitCache();
 
+    UseGlobalLock = !KnobLockFree;
+    if (!UseGlobalLock && Levels >= 3)
+        Hierarchies[2].dl1[0].SetShared(SHARED_CACHE_SHARDS);
+
+    if( KnobMissRatioCurves )
+        InitStackDistance(KnobMissRatioSampling);
+
+    if( KnobPCProfile )
+        InitPCProfile();
+
+    if( !KnobTraceFile.Value().empty() )
+        StartTrace();
+    else if( KnobBuffered )
+        StartWorkers();
+
+    if( KnobDetailed > 0 )
+        StartTimeSampling();
+
+    if( KnobInterval > 0 && TraceFile == NULL )
+        StartIntervals();
+
+    // Per-access profiles need every access, buffering and capture record
+    // every access anyway
+    if( KnobCoalesce && TraceFile == NULL && !KnobBuffered && !KnobMissRatioCurves && !KnobPCProfile ){
+        InitCoalescing();
+
+        CoalesceFetches = KnobTrackInstructions;
+        if( CoalesceFetches )
+            TRACE_AddInstrumentFunction(InstructionTrace, 0);
+
+        FilterReg = PIN_ClaimToolRegister();
+        LineFilter = REG_valid(FilterReg);
+    }
+
     PIN_AddThreadStartFunction(ThreadStart, 0);
     IMG_AddInstrumentFunction(binName, 0);
     INS_AddInstrumentFunction(Instruction, 0);